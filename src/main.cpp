@@ -22,12 +22,26 @@ const uint16_t COLOR_TEXT_TERTIARY           = 0x4208;
 const uint16_t COLOR_MENU_ITEM_PRESSED       = TFT_GREEN;
 const uint16_t COLOR_WIFI_QR_TEXT            = TFT_CYAN;
 const uint16_t COLOR_MENU_SEPARATOR          = 0x2104;
+const uint16_t COLOR_BANNER_BG               = 0x2104;
 
 // --- Timing e Animazioni ---
 const unsigned long ANIMATION_DURATION_SET   = 600; // ms
-const unsigned long DEBOUNCE_DELAY           = 500; // ms 
 const unsigned long SLEEP_MODE_TIMEOUT       = 600000; // 10 minuti
 
+const unsigned long ANIMATION_DURATION_TRANSITION = 450; // ms
+const unsigned long IDLE_LOOP_DELAY          = 10; // ms, pausa del loop quando nulla è in animazione
+const unsigned long BOOT_FIRST_FRAME_BUDGET  = 250; // ms, tempo massimo dall'avvio al primo frame del menu
+const unsigned long PROGRAM_BANNER_DURATION  = 1500; // ms, nome del programma mostrato dopo un cambio
+
+// --- Riconoscimento Gesti ---
+const int           GESTURE_TAP_SLOP         = 12;  // px, spostamento massimo per un tap o una pressione lunga
+const int           GESTURE_SWIPE_MIN_DIST   = 30;  // px
+const unsigned long GESTURE_SWIPE_MIN_SPEED  = 150; // px/s
+const unsigned long GESTURE_LONG_PRESS_TIME  = 600; // ms
+const unsigned long GESTURE_RELEASE_TIMEOUT  = 100; // ms senza campioni dopo i quali il dito è considerato sollevato
+const int           GESTURE_MIN_SAMPLES      = 3;   // sotto questa soglia il tratto non è classificabile dai punti grezzi
+const unsigned long TOUCH_LATENCY_REPORT     = 20;  // gesti misurati per ogni riepilogo della latenza
+
 // --- Layout ---
 const int PADDING_HORIZONTAL                 = 20;
 const int SCREEN_W                           = 240;
@@ -37,6 +51,10 @@ const int SCREEN_H                           = 240;
 const size_t MAX_EXERCISE_NAME_LEN    = 30;
 const size_t MAX_DAY_NAME_LEN         = 50;
 const size_t MAX_MUSCLE_GROUP_LEN     = 50;
+const size_t MAX_PROGRAM_NAME_LEN     = 24;
+const int    MAX_PROGRAMS             = 8;
+const int    MAX_GIORNI               = 7;
+const int    DAY_CACHE_SIZE           = 2; // giorni tenuti in RAM contemporaneamente
 
 
 // --- Configurazione LovyanGFX ---
@@ -69,16 +87,668 @@ CST816S touch(TOUCH_SDA, TOUCH_SCL, TOUCH_RST, TOUCH_INT);
 // --- Struttura Dati Globale ---
 struct Esercizio { char nome[MAX_EXERCISE_NAME_LEN]; int serie; int ripetizioni; };
 struct GiornoAllenamento { char nomeGiorno[MAX_DAY_NAME_LEN]; char gruppiMuscolari[MAX_MUSCLE_GROUP_LEN]; Esercizio esercizi[10]; int numeroEsercizi; };
-GiornoAllenamento miaScheda[7];
-int numeroGiorniTotali = 0;
 int giornoCorrente = 0;
 
+// Titoli di un giorno, tutto ciò che serve al menu senza caricare gli esercizi
+struct VoceMenu { char nomeGiorno[MAX_DAY_NAME_LEN]; char gruppiMuscolari[MAX_MUSCLE_GROUP_LEN]; };
+
 // --- Variabili Globali di Sistema ---
 LGFX tft;
 Preferences preferences;
 DNSServer dnsServer;
 AsyncWebServer server(80);
 const char* const ssid_ap = "GymBuddy-Setup";
+bool webServerPronto = false;
+bool filesystemPronto = false;
+
+// --- Profilazione dell'Avvio ---
+struct BootStage { const char* nome; unsigned long us; };
+const int MAX_BOOT_STAGES = 12;
+BootStage bootStages[MAX_BOOT_STAGES];
+int numeroBootStages = 0;
+bool bootCompletato = false;
+
+// =======================================================================
+//  ARCHIVIO DEI PROGRAMMI SU FLASH
+// =======================================================================
+// Più programmi con nome. L'NVS (20 KB, condivisa con il Wi-Fi) tiene solo il minimo per l'avvio:
+//   "prog_idx"   indice (nomi, numero di giorni, generazione dei file, programma attivo)
+//   "menu_att"   copia dei titoli del programma attivo, per disegnare il menu senza montare SPIFFS
+// I dati veri stanno su SPIFFS, montato solo al primo accesso:
+//   /prog<P>g<G>_menu.bin  titoli dei giorni del programma P, generazione G
+//   /prog<P>g<G>_d<D>.bin  giorno D completo del programma P, generazione G
+// Un salvataggio scrive una nuova generazione di file accanto a quella vecchia: l'unico punto
+// di conferma è la scrittura di "prog_idx" con il nuovo numero di generazione, dopo la quale
+// i file vecchi vengono cancellati. Se qualcosa fallisce prima, resta valida la generazione precedente.
+// In RAM restano solo l'indice, i titoli del programma attivo e una piccola
+// cache LRU di giorni, caricati quando vengono selezionati dal menu.
+// Finché non c'è nessun salvataggio il programma di esempio vive solo in RAM.
+struct IndiceProgrammi {
+    uint8_t numeroProgrammi;
+    uint8_t programmaAttivo;
+    uint8_t numeroGiorni[MAX_PROGRAMS];
+    uint8_t generazione[MAX_PROGRAMS];
+    uint8_t perso[MAX_PROGRAMS]; // file spariti da SPIFFS, es. dopo un uploadfs
+    char nomi[MAX_PROGRAMS][MAX_PROGRAM_NAME_LEN];
+};
+
+const char* const DEFAULT_WORKOUT_DAY = "Esempio|Petto|Panca Piana:4:8,Spinte Manubri:3:10";
+
+bool ensureFilesystem(bool formatIfFailed);
+bool parseWorkoutDay(const String& dayData, GiornoAllenamento& out);
+
+class ProgramStore {
+private:
+    struct SlotGiorno { int8_t giorno; bool valido; uint32_t ultimoUso; GiornoAllenamento dati; };
+
+    IndiceProgrammi indice = {};
+    VoceMenu voci[MAX_GIORNI] = {};
+    SlotGiorno cache[DAY_CACHE_SIZE];
+    uint32_t contatoreUso = 0;
+    bool predefinito = false; // programma di esempio non ancora scritto in flash
+
+    static void percorsoMenu(char* path, int p, int g) { snprintf(path, 32, "/prog%dg%d_menu.bin", p, g); }
+    static void percorsoGiorno(char* path, int p, int g, int d) { snprintf(path, 32, "/prog%dg%d_d%d.bin", p, g, d); }
+
+    uint8_t prossimaGenerazione(int p) const { return indice.generazione[p] + 1; }
+
+    static bool scriviFile(const char* path, const void* dati, size_t len) {
+        File f = SPIFFS.open(path, FILE_WRITE);
+        if (!f) return false;
+        size_t scritti = f.write((const uint8_t*)dati, len);
+        f.close();
+        return scritti == len;
+    }
+
+    static bool leggiFile(const char* path, void* dati, size_t len) {
+        if (!ensureFilesystem(false)) return false;
+        File f = SPIFFS.open(path, FILE_READ);
+        if (!f) return false;
+        bool ok = f.size() == len && f.read((uint8_t*)dati, len) == len;
+        f.close();
+        return ok;
+    }
+
+    static void cancellaGenerazione(int p, int g) {
+        char path[32];
+        percorsoMenu(path, p, g);
+        if (SPIFFS.exists(path)) SPIFFS.remove(path);
+        for (int d = 0; d < MAX_GIORNI; d++) {
+            percorsoGiorno(path, p, g, d);
+            if (SPIFFS.exists(path)) SPIFFS.remove(path);
+        }
+    }
+
+    static void giornoPredefinito(GiornoAllenamento& g) { parseWorkoutDay(DEFAULT_WORKOUT_DAY, g); }
+
+    void svuotaCache() {
+        for (int i = 0; i < DAY_CACHE_SIZE; i++) cache[i].giorno = -1;
+    }
+
+    static void terminaVoci(VoceMenu* v) {
+        for (int d = 0; d < MAX_GIORNI; d++) {
+            v[d].nomeGiorno[MAX_DAY_NAME_LEN - 1] = '\0';
+            v[d].gruppiMuscolari[MAX_MUSCLE_GROUP_LEN - 1] = '\0';
+        }
+    }
+
+    // Titoli del programma attivo in RAM e nella copia in NVS (non critica: begin() può ripiegare sul file)
+    void impostaTitoli(const VoceMenu* nuoveVoci) {
+        size_t len = numeroGiorni() * sizeof(VoceMenu);
+        VoceMenu copia[MAX_GIORNI] = {};
+        memcpy(copia, nuoveVoci, len);
+        memcpy(voci, copia, sizeof(voci));
+        terminaVoci(voci);
+        if (len > 0) preferences.putBytes("menu_att", voci, len);
+        svuotaCache();
+    }
+
+    // Scrive l'indice: è il punto di conferma di ogni modifica all'archivio.
+    // La copia dei titoli viene tolta prima, così non può mai restare disallineata dall'indice.
+    bool salvaIndice() {
+        preferences.remove("menu_att");
+        return preferences.putBytes("prog_idx", &indice, sizeof(indice)) == sizeof(indice);
+    }
+
+    // Una lettura è fallita con SPIFFS montato: i file del programma non ci sono più
+    void segnaPerso(int p) {
+        if (predefinito || !ensureFilesystem(false)) return;
+        Serial.printf("Programma %d non trovato su SPIFFS\n", p);
+        indice.perso[p] = 1;
+        indice.numeroGiorni[p] = 0;
+        bool tuttiPersi = true;
+        for (int i = 0; i < indice.numeroProgrammi; i++) {
+            if (!indice.perso[i]) tuttiPersi = false;
+        }
+        if (tuttiPersi) {
+            // Tipicamente dopo un uploadfs: si riparte dal programma di esempio
+            preferences.remove("prog_idx");
+            preferences.remove("menu_att");
+            caricaPredefinito();
+            return;
+        }
+        if (!salvaIndice()) return;
+        if (p == indice.programmaAttivo) {
+            memset(voci, 0, sizeof(voci));
+            svuotaCache();
+        } else {
+            impostaTitoli(voci);
+        }
+    }
+
+    SlotGiorno& slot(int d) {
+        int scelto = 0;
+        for (int i = 0; i < DAY_CACHE_SIZE; i++) {
+            if (cache[i].giorno == d) { cache[i].ultimoUso = ++contatoreUso; return cache[i]; }
+            if (cache[i].giorno < 0 || (cache[scelto].giorno >= 0 && cache[i].ultimoUso < cache[scelto].ultimoUso)) scelto = i;
+        }
+        bool valido = leggiGiorno(indice.programmaAttivo, d, cache[scelto].dati);
+        // Una lettura fallita non resta in cache: il giorno verrà riletto alla prossima richiesta
+        cache[scelto].giorno = valido ? d : -1;
+        cache[scelto].valido = valido;
+        cache[scelto].ultimoUso = ++contatoreUso;
+        return cache[scelto];
+    }
+
+    // Prima di salvare un altro programma, quello di esempio va scritto come programma 0
+    bool persistiPredefinito() {
+        GiornoAllenamento g;
+        giornoPredefinito(g);
+        VoceMenu v[MAX_GIORNI] = {};
+        memcpy(v[0].nomeGiorno, g.nomeGiorno, MAX_DAY_NAME_LEN);
+        memcpy(v[0].gruppiMuscolari, g.gruppiMuscolari, MAX_MUSCLE_GROUP_LEN);
+        char nome[MAX_PROGRAM_NAME_LEN];
+        memcpy(nome, indice.nomi[0], sizeof(nome));
+        predefinito = false;
+        if (salvaGiorno(0, 0, g) && salvaProgramma(0, nome, v, 1)) return true;
+        annullaSalvataggio(0);
+        predefinito = true;
+        return false;
+    }
+
+public:
+    ProgramStore() { svuotaCache(); }
+
+    // Legge solo l'indice e i titoli del programma attivo dall'NVS; false se l'archivio non esiste
+    bool begin() {
+        if (preferences.getBytesLength("prog_idx") != sizeof(indice)) return false;
+        preferences.getBytes("prog_idx", &indice, sizeof(indice));
+        if (indice.numeroProgrammi == 0 || indice.numeroProgrammi > MAX_PROGRAMS) { indice = {}; return false; }
+        if (indice.programmaAttivo >= indice.numeroProgrammi) indice.programmaAttivo = 0;
+        for (int p = 0; p < MAX_PROGRAMS; p++) {
+            if (indice.numeroGiorni[p] > MAX_GIORNI || indice.perso[p]) indice.numeroGiorni[p] = 0;
+            indice.nomi[p][MAX_PROGRAM_NAME_LEN - 1] = '\0';
+        }
+        predefinito = false;
+        size_t len = numeroGiorni() * sizeof(VoceMenu);
+        if (preferences.getBytesLength("menu_att") == len) {
+            preferences.getBytes("menu_att", voci, len);
+        } else if (len > 0) {
+            // Copia in NVS mancante: si ripiega sul file, al costo di montare SPIFFS
+            char path[32];
+            percorsoMenu(path, indice.programmaAttivo, indice.generazione[indice.programmaAttivo]);
+            if (!leggiFile(path, voci, len)) segnaPerso(indice.programmaAttivo);
+        }
+        terminaVoci(voci);
+        return true;
+    }
+
+    // Programma di esempio tenuto solo in RAM: nessuna scrittura in flash fino al primo salvataggio
+    void caricaPredefinito() {
+        indice = {};
+        indice.numeroProgrammi = 1;
+        indice.numeroGiorni[0] = 1;
+        strncpy(indice.nomi[0], "Programma 1", MAX_PROGRAM_NAME_LEN - 1);
+        GiornoAllenamento g;
+        giornoPredefinito(g);
+        memset(voci, 0, sizeof(voci));
+        memcpy(voci[0].nomeGiorno, g.nomeGiorno, MAX_DAY_NAME_LEN);
+        memcpy(voci[0].gruppiMuscolari, g.gruppiMuscolari, MAX_MUSCLE_GROUP_LEN);
+        predefinito = true;
+        svuotaCache();
+    }
+
+    int numeroProgrammi() const { return indice.numeroProgrammi; }
+    int programmaAttivo() const { return indice.programmaAttivo; }
+    bool programmaValido(int p) const { return p >= 0 && p < indice.numeroProgrammi && !indice.perso[p]; }
+    const char* nomeProgramma(int p) const { return (p >= 0 && p < indice.numeroProgrammi) ? indice.nomi[p] : ""; }
+    int numeroGiorni(int p) const { return (p >= 0 && p < indice.numeroProgrammi) ? indice.numeroGiorni[p] : 0; }
+    int numeroGiorni() const { return numeroGiorni(indice.programmaAttivo); }
+    const VoceMenu& voce(int d) const { return voci[constrain(d, 0, MAX_GIORNI - 1)]; }
+
+    // Legge un giorno direttamente dalla flash, senza passare dalla cache
+    bool leggiGiorno(int p, int d, GiornoAllenamento& out) {
+        memset(&out, 0, sizeof(out));
+        if (d < 0 || d >= numeroGiorni(p)) return false;
+        if (predefinito) { giornoPredefinito(out); return true; }
+        char path[32];
+        percorsoGiorno(path, p, indice.generazione[p], d);
+        if (!leggiFile(path, &out, sizeof(out))) {
+            memset(&out, 0, sizeof(out));
+            segnaPerso(p);
+            return false;
+        }
+        out.nomeGiorno[MAX_DAY_NAME_LEN - 1] = '\0';
+        out.gruppiMuscolari[MAX_MUSCLE_GROUP_LEN - 1] = '\0';
+        out.numeroEsercizi = constrain(out.numeroEsercizi, 0, 10);
+        for (int e = 0; e < out.numeroEsercizi; e++) out.esercizi[e].nome[MAX_EXERCISE_NAME_LEN - 1] = '\0';
+        return true;
+    }
+
+    // Giorno del programma attivo: dalla cache se presente, altrimenti sostituisce quello usato meno di recente.
+    // Il riferimento resta valido finché non vengono richiesti altri DAY_CACHE_SIZE giorni diversi.
+    GiornoAllenamento& giorno(int d) { return slot(d).dati; }
+
+    // Carica il giorno in cache; false se non è stato possibile leggerlo
+    bool precarica(int d) { return slot(d).valido; }
+
+    bool selezionaProgramma(int p) {
+        if (!programmaValido(p)) return false;
+        if (p == indice.programmaAttivo) return true;
+        VoceMenu nuoveVoci[MAX_GIORNI] = {};
+        char path[32];
+        percorsoMenu(path, p, indice.generazione[p]);
+        if (!leggiFile(path, nuoveVoci, indice.numeroGiorni[p] * sizeof(VoceMenu))) {
+            segnaPerso(p);
+            return false;
+        }
+        uint8_t precedente = indice.programmaAttivo;
+        indice.programmaAttivo = p;
+        if (!salvaIndice()) {
+            indice.programmaAttivo = precedente;
+            impostaTitoli(voci);
+            return false;
+        }
+        impostaTitoli(nuoveVoci);
+        return true;
+    }
+
+    // Salvataggio: salvaGiorno scrive ogni giorno nella nuova generazione di file del programma,
+    // salvaProgramma scrive i titoli e conferma tutto con un'unica scrittura dell'indice.
+    bool salvaGiorno(int p, int d, const GiornoAllenamento& g) {
+        if (p < 0 || p >= MAX_PROGRAMS || d < 0 || d >= MAX_GIORNI || !ensureFilesystem(true)) return false;
+        char path[32];
+        percorsoGiorno(path, p, prossimaGenerazione(p), d);
+        return scriviFile(path, &g, sizeof(g));
+    }
+
+    // Scarta la generazione in costruzione di un salvataggio non riuscito
+    void annullaSalvataggio(int p) {
+        if (p < 0 || p >= MAX_PROGRAMS || !ensureFilesystem(false)) return;
+        cancellaGenerazione(p, prossimaGenerazione(p));
+    }
+
+    // p == numeroProgrammi() crea un nuovo programma. Il programma salvato diventa quello attivo.
+    bool salvaProgramma(int p, const char* nome, const VoceMenu* nuoveVoci, int giorni) {
+        if (p < 0 || p > indice.numeroProgrammi || p >= MAX_PROGRAMS || giorni < 0 || giorni > MAX_GIORNI || !ensureFilesystem(true)) {
+            return false;
+        }
+        if (predefinito && p != 0 && !persistiPredefinito()) return false;
+
+        uint8_t generazione = prossimaGenerazione(p);
+        char path[32];
+        percorsoMenu(path, p, generazione);
+        if (!scriviFile(path, nuoveVoci, giorni * sizeof(VoceMenu))) return false;
+
+        IndiceProgrammi precedente = indice;
+        strncpy(indice.nomi[p], nome, MAX_PROGRAM_NAME_LEN - 1);
+        indice.nomi[p][MAX_PROGRAM_NAME_LEN - 1] = '\0';
+        indice.numeroGiorni[p] = giorni;
+        indice.generazione[p] = generazione;
+        indice.perso[p] = 0;
+        indice.programmaAttivo = p;
+        if (p == indice.numeroProgrammi) indice.numeroProgrammi++;
+        if (!salvaIndice()) {
+            indice = precedente;
+            impostaTitoli(voci);
+            return false;
+        }
+
+        // Confermato: la generazione precedente non serve più
+        bool eraSoloInRam = predefinito;
+        predefinito = false;
+        if (!eraSoloInRam && p < precedente.numeroProgrammi) cancellaGenerazione(p, precedente.generazione[p]);
+        impostaTitoli(nuoveVoci);
+        return true;
+    }
+};
+
+ProgramStore schede;
+
+// =======================================================================
+//  MOTORE DI ANIMAZIONE (TWEEN) A VIRGOLA FISSA
+// =======================================================================
+// L'ESP32-C3 non ha FPU: ogni operazione float è emulata in software.
+// Tutte le animazioni usano quindi valori Q12 (0..FX_ONE), curve di easing
+// precalcolate in tabella e un unico orologio campionato una volta per frame.
+typedef uint16_t fixed_t;
+const int     FX_SHIFT = 12;
+const fixed_t FX_ONE   = 1 << FX_SHIFT;
+
+enum Easing : uint8_t { EASE_LINEAR, EASE_OUT_CUBIC, EASE_IN_OUT_SINE };
+
+// Tabelle a 65 punti (passo 1/64), interpolate linearmente tra un punto e l'altro
+const int EASING_TABLE_BITS = 6;
+const uint16_t EASE_OUT_CUBIC_TABLE[(1 << EASING_TABLE_BITS) + 1] = {
+    0, 189, 372, 549, 721, 887, 1047, 1202, 1352, 1496, 1636, 1770, 1899, 2023, 2143, 2258,
+    2368, 2474, 2575, 2672, 2765, 2854, 2938, 3019, 3096, 3169, 3239, 3305, 3367, 3426, 3482, 3534,
+    3584, 3631, 3674, 3715, 3753, 3788, 3821, 3852, 3880, 3906, 3930, 3951, 3971, 3989, 4005, 4019,
+    4032, 4043, 4053, 4062, 4069, 4075, 4080, 4085, 4088, 4091, 4093, 4094, 4095, 4096, 4096, 4096,
+    4096
+};
+const uint16_t EASE_IN_OUT_SINE_TABLE[(1 << EASING_TABLE_BITS) + 1] = {
+    0, 2, 10, 22, 39, 61, 88, 120, 156, 197, 242, 291, 345, 403, 465, 531,
+    600, 673, 749, 828, 910, 995, 1083, 1172, 1264, 1358, 1453, 1550, 1648, 1747, 1847, 1948,
+    2048, 2148, 2249, 2349, 2448, 2546, 2643, 2738, 2832, 2924, 3013, 3101, 3186, 3268, 3347, 3423,
+    3496, 3565, 3631, 3693, 3751, 3805, 3854, 3899, 3940, 3976, 4008, 4035, 4057, 4074, 4086, 4094,
+    4096
+};
+
+fixed_t applyEasing(Easing easing, fixed_t t) {
+    const uint16_t* table;
+    switch (easing) {
+        case EASE_OUT_CUBIC:   table = EASE_OUT_CUBIC_TABLE; break;
+        case EASE_IN_OUT_SINE: table = EASE_IN_OUT_SINE_TABLE; break;
+        default:               return t;
+    }
+    if (t >= FX_ONE) return FX_ONE;
+    const int fracBits = FX_SHIFT - EASING_TABLE_BITS;
+    int idx = t >> fracBits;
+    int frac = t & ((1 << fracBits) - 1);
+    return table[idx] + (((table[idx + 1] - table[idx]) * frac) >> fracBits);
+}
+
+// Seno in Q12 per ogni grado del primo quadrante; gli altri si ricavano per simmetria
+const int16_t SINE_TABLE[91] = {
+    0, 71, 143, 214, 286, 357, 428, 499, 570, 641, 711, 782, 852, 921, 991, 1060,
+    1129, 1198, 1266, 1334, 1401, 1468, 1534, 1600, 1666, 1731, 1796, 1860, 1923, 1986, 2048, 2110,
+    2171, 2231, 2290, 2349, 2408, 2465, 2522, 2578, 2633, 2687, 2741, 2793, 2845, 2896, 2946, 2996,
+    3044, 3091, 3138, 3183, 3228, 3271, 3314, 3355, 3396, 3435, 3474, 3511, 3547, 3582, 3617, 3650,
+    3681, 3712, 3742, 3770, 3798, 3824, 3849, 3873, 3896, 3917, 3937, 3956, 3974, 3991, 4006, 4021,
+    4034, 4046, 4056, 4065, 4074, 4080, 4086, 4090, 4094, 4095, 4096
+};
+
+int sinDeg(int deg) {
+    deg %= 360;
+    if (deg < 0) deg += 360;
+    if (deg <= 90)  return SINE_TABLE[deg];
+    if (deg <= 180) return SINE_TABLE[180 - deg];
+    if (deg <= 270) return -SINE_TABLE[deg - 180];
+    return -SINE_TABLE[360 - deg];
+}
+
+int cosDeg(int deg) { return sinDeg(deg + 90); }
+
+// --- Rampa di colori RGB565 precalcolata tra due estremi ---
+const int COLOR_RAMP_BITS = 5;
+class ColorRamp {
+private:
+    uint16_t steps[(1 << COLOR_RAMP_BITS) + 1];
+public:
+    ColorRamp(uint16_t from, uint16_t to) {
+        const int n = 1 << COLOR_RAMP_BITS;
+        int r0 = (from >> 11) & 0x1F, g0 = (from >> 5) & 0x3F, b0 = from & 0x1F;
+        int r1 = (to >> 11) & 0x1F,   g1 = (to >> 5) & 0x3F,   b1 = to & 0x1F;
+        for (int i = 0; i <= n; i++) {
+            int r = r0 + (r1 - r0) * i / n;
+            int g = g0 + (g1 - g0) * i / n;
+            int b = b0 + (b1 - b0) * i / n;
+            steps[i] = (r << 11) | (g << 5) | b;
+        }
+    }
+    uint16_t at(fixed_t t) const {
+        if (t >= FX_ONE) return steps[1 << COLOR_RAMP_BITS];
+        return steps[t >> (FX_SHIFT - COLOR_RAMP_BITS)];
+    }
+};
+
+// --- Gestore delle animazioni: orologio unico e pool di tween ---
+typedef int8_t TweenId;
+const TweenId NO_TWEEN = -1;
+const int MAX_TWEENS = 4;
+
+// TWEEN_ONCE chiede un frame a ogni loop finché è attivo. TWEEN_LOOP e TWEEN_TIMER no:
+// chi usa un tween ciclico ridisegna solo quando il valore visibile cambia, un timer non disegna nulla.
+enum TweenMode : uint8_t { TWEEN_ONCE, TWEEN_LOOP, TWEEN_TIMER };
+
+class TweenEngine {
+private:
+    enum State : uint8_t { IDLE, RUNNING, FINISHED };
+    struct Tween {
+        unsigned long startTime;
+        unsigned long duration;
+        Easing easing;
+        TweenMode mode;
+        State state;
+    };
+    Tween pool[MAX_TWEENS] = {};
+    unsigned long now = 0;
+
+    bool valid(TweenId id) const { return id >= 0 && id < MAX_TWEENS; }
+
+    fixed_t linear(const Tween& tw) const {
+        if (tw.state == FINISHED) return FX_ONE;
+        if (tw.state != RUNNING || tw.duration == 0) return 0;
+        unsigned long elapsed = now - tw.startTime;
+        if (tw.mode == TWEEN_LOOP) elapsed %= tw.duration;
+        else if (elapsed >= tw.duration) return FX_ONE;
+        return (fixed_t)((elapsed << FX_SHIFT) / tw.duration);
+    }
+
+public:
+    // Da chiamare una sola volta all'inizio di ogni iterazione del loop
+    void tick() {
+        now = millis();
+        for (int i = 0; i < MAX_TWEENS; i++) {
+            Tween& tw = pool[i];
+            if (tw.state == RUNNING && tw.mode != TWEEN_LOOP && now - tw.startTime >= tw.duration) {
+                tw.state = FINISHED;
+            }
+        }
+    }
+
+    unsigned long clock() const { return now; }
+
+    TweenId start(unsigned long duration, Easing easing, TweenMode mode = TWEEN_ONCE) {
+        for (int i = 0; i < MAX_TWEENS; i++) {
+            if (pool[i].state == IDLE) {
+                pool[i] = { now, duration, easing, mode, RUNNING };
+                return i;
+            }
+        }
+        return NO_TWEEN;
+    }
+
+    // Libera lo slot; l'id passato viene azzerato
+    void stop(TweenId& id) {
+        if (valid(id)) pool[id].state = IDLE;
+        id = NO_TWEEN;
+    }
+
+    bool isActive(TweenId id) const { return valid(id) && pool[id].state != IDLE; }
+
+    // Vero una sola volta quando il tween è terminato: libera lo slot e azzera l'id
+    bool finished(TweenId& id) {
+        if (!valid(id) || pool[id].state != FINISHED) return false;
+        stop(id);
+        return true;
+    }
+
+    fixed_t progress(TweenId id) const { return valid(id) ? linear(pool[id]) : 0; }
+    fixed_t value(TweenId id) const { return valid(id) ? applyEasing(pool[id].easing, linear(pool[id])) : 0; }
+
+    // Se falso non c'è nulla da ridisegnare e il dispositivo può restare a riposo
+    bool anyActive() const {
+        for (int i = 0; i < MAX_TWEENS; i++) {
+            if (pool[i].state != IDLE && pool[i].mode == TWEEN_ONCE) return true;
+        }
+        return false;
+    }
+};
+
+TweenEngine tweens;
+const ColorRamp seriesDotRamp(COLOR_PROGRESS_BAR_BG, COLOR_PROGRESS_BAR_FG);
+
+// =======================================================================
+//  RICONOSCIMENTO DEI GESTI DAI PUNTI GREZZI DEL TOUCH
+// =======================================================================
+// Il gestureID del CST816S arriva solo a gesto concluso e la vecchia gestione
+// scartava ogni tocco per 500 ms dopo un cambio schermata. Qui ogni campione
+// letto su TOUCH_INT alimenta un riconoscitore che classifica il tratto
+// (dal contatto al rilascio) e mette il gesto in una piccola coda circolare.
+enum GestureType : uint8_t {
+    GESTURE_TAP, GESTURE_LONG_PRESS,
+    GESTURE_SWIPE_UP, GESTURE_SWIPE_DOWN, GESTURE_SWIPE_LEFT, GESTURE_SWIPE_RIGHT
+};
+
+struct GestureEvent {
+    GestureType type;
+    int16_t x, y;          // punto di partenza del tratto
+    uint16_t strokeId;     // tratto che ha generato il gesto
+    unsigned long sampleUs; // micros() del campione che ha concluso il gesto
+};
+
+// Valori del campo "event" nei report del CST816S
+const uint8_t TOUCH_EVENT_DOWN    = 0;
+const uint8_t TOUCH_EVENT_UP      = 1;
+const uint8_t TOUCH_EVENT_CONTACT = 2;
+
+const int GESTURE_QUEUE_SIZE = 8;
+
+class GestureRecognizer {
+private:
+    GestureEvent queue[GESTURE_QUEUE_SIZE];
+    uint8_t head = 0, count = 0;
+
+    bool tracking = false;
+    bool longPressSent = false;
+    bool releasedByUp = true; // l'ultimo tratto si è chiuso con un vero "up" (o non ce ne sono stati)
+    uint8_t samples = 0;
+    uint16_t strokeId = 0;
+    int16_t startX = 0, startY = 0, lastX = 0, lastY = 0;
+    unsigned long startTime = 0, lastTime = 0, lastSampleUs = 0;
+    uint8_t chipGesture = NONE;
+
+    void push(GestureType type, unsigned long sampleUs) {
+        // Coda piena: si perde il gesto più vecchio, non quello appena fatto
+        if (count == GESTURE_QUEUE_SIZE) { head = (head + 1) % GESTURE_QUEUE_SIZE; count--; }
+        queue[(head + count) % GESTURE_QUEUE_SIZE] = { type, startX, startY, strokeId, sampleUs };
+        count++;
+    }
+
+    int movement() const { return max(abs(lastX - startX), abs(lastY - startY)); }
+
+    void endStroke(bool byUp) {
+        tracking = false;
+        releasedByUp = byUp;
+        if (longPressSent) return;
+
+        int dx = lastX - startX, dy = lastY - startY;
+        int dist = movement();
+        unsigned long dt = max(1UL, lastTime - startTime);
+        if (dist >= GESTURE_SWIPE_MIN_DIST && (unsigned long)dist * 1000 / dt >= GESTURE_SWIPE_MIN_SPEED) {
+            if (abs(dx) > abs(dy)) push(dx > 0 ? GESTURE_SWIPE_RIGHT : GESTURE_SWIPE_LEFT, lastSampleUs);
+            else                   push(dy > 0 ? GESTURE_SWIPE_DOWN : GESTURE_SWIPE_UP, lastSampleUs);
+            return;
+        }
+        // Solo un tratto con troppo pochi campioni si affida al gesto riconosciuto dal controller:
+        // uno lento ma ben campionato resta scartato dalla soglia di velocità
+        if (samples < GESTURE_MIN_SAMPLES) {
+            switch (chipGesture) {
+                case SWIPE_UP:    push(GESTURE_SWIPE_UP, lastSampleUs); return;
+                case SWIPE_DOWN:  push(GESTURE_SWIPE_DOWN, lastSampleUs); return;
+                case SWIPE_LEFT:  push(GESTURE_SWIPE_LEFT, lastSampleUs); return;
+                case SWIPE_RIGHT: push(GESTURE_SWIPE_RIGHT, lastSampleUs); return;
+                default: break;
+            }
+        }
+        if (dist <= GESTURE_TAP_SLOP) push(GESTURE_TAP, lastSampleUs);
+    }
+
+    void checkLongPress(unsigned long now) {
+        if (tracking && !longPressSent && now - startTime >= GESTURE_LONG_PRESS_TIME && movement() <= GESTURE_TAP_SLOP) {
+            longPressSent = true;
+            push(GESTURE_LONG_PRESS, micros());
+        }
+    }
+
+public:
+    void addSample(int x, int y, uint8_t event, uint8_t gestureID, unsigned long now, unsigned long us) {
+        if (!tracking) {
+            // Un tratto si apre solo con un "down", o con un contatto dopo un rilascio vero.
+            // Gli "up" orfani non generano gesti ma confermano che il dito è sollevato,
+            // così il prossimo tratto può aprirsi anche se il primo campione letto è un contatto.
+            if (event == TOUCH_EVENT_UP) { releasedByUp = true; return; }
+            if (event != TOUCH_EVENT_DOWN && !(event == TOUCH_EVENT_CONTACT && releasedByUp)) return;
+        } else if (event == TOUCH_EVENT_DOWN) {
+            endStroke(false); // rilascio perso: si chiude il tratto precedente
+        }
+        if (!tracking) {
+            tracking = true;
+            longPressSent = false;
+            samples = 0;
+            strokeId++;
+            startX = x; startY = y;
+            startTime = now;
+            chipGesture = NONE;
+        }
+        if (samples < 255) samples++;
+        lastX = x; lastY = y;
+        lastTime = now;
+        lastSampleUs = us;
+        if (gestureID != NONE) chipGesture = gestureID;
+
+        if (event == TOUCH_EVENT_UP) endStroke(true);
+        else checkLongPress(now);
+    }
+
+    // Da chiamare a ogni loop: pressione lunga e rilascio senza report di "up"
+    void service(unsigned long now) {
+        if (!tracking) return;
+        if (now - lastTime > GESTURE_RELEASE_TIMEOUT) endStroke(false);
+        else checkLongPress(now);
+    }
+
+    bool poll(GestureEvent& ev) {
+        if (count == 0) return false;
+        ev = queue[head];
+        head = (head + 1) % GESTURE_QUEUE_SIZE;
+        count--;
+        return true;
+    }
+
+    bool isTracking() const { return tracking; }
+    uint16_t currentStroke() const { return strokeId; }
+};
+
+// --- Misura della latenza tocco-schermo ---
+// Dalla lettura I2C del campione che conclude un gesto al primo frame inviato al pannello.
+// Il tempo tra TOUCH_INT e la lettura (fino a IDLE_LOOP_DELAY a riposo) non è incluso.
+// Il riepilogo su seriale si abilita compilando con -DTOUCH_LATENCY_LOG.
+class TouchLatencyProbe {
+private:
+    bool pending = false;
+    unsigned long startUs = 0;
+    unsigned long samples = 0, totalUs = 0, worstUs = 0;
+public:
+    void begin(unsigned long sampleUs) { pending = true; startUs = sampleUs; }
+    void framePresented() {
+        if (!pending) return;
+        pending = false;
+        unsigned long latency = micros() - startUs;
+        samples++;
+        totalUs += latency;
+        if (latency > worstUs) worstUs = latency;
+#ifdef TOUCH_LATENCY_LOG
+        if (samples % TOUCH_LATENCY_REPORT == 0) {
+            Serial.printf("[touch] latenza media %lu us, max %lu us su %lu gesti\n", totalUs / samples, worstUs, samples);
+        }
+#endif
+    }
+};
+
+GestureRecognizer gestures;
+TouchLatencyProbe touchLatency;
 
 // =======================================================================
 //  ARCHITETTURA A OGGETTI PER LE SCHERMATE
@@ -93,11 +763,11 @@ enum TransitionType { HORIZONTAL, VERTICAL };
 Screen* currentScreen = nullptr;
 Screen* transitionToScreen = nullptr;
 bool isTransitioning = false;
-float transitionProgress = 0.0f;
+TweenId transitionTween = NO_TWEEN;
 int transitionDirection = 1;
 TransitionType currentTransitionType = HORIZONTAL; // Memorizza il tipo di transizione corrente
 LGFX_Sprite bufA(&tft), bufB(&tft);
-unsigned long ignoreTouchUntilMillis = 0;
+uint16_t inputEpoch = 0; // ultimo tratto appartenente alla schermata precedente
 unsigned long ultimaAttivitaMillis = 0;
 bool needsRedraw = true; // Flag per ottimizzare il ciclo di disegno
 
@@ -105,12 +775,16 @@ bool needsRedraw = true; // Flag per ottimizzare il ciclo di disegno
 // MODIFICA: Aggiornata la firma della funzione per accettare il tipo di transizione
 void changeScreen(Screen* newScreen, int direction, TransitionType type = HORIZONTAL);
 void performTransitionFrame();
+void pollTouch();
 void drawQrCode(LGFX_Sprite* canvas, int x_offset, int y_offset, QRCode* qrcode, int scale);
-void drawSeriesDotsOnCanvas(LGFX_Sprite* canvas, int completed, int total, bool animating, unsigned long animStart, unsigned long animDur);
-void deserializeWorkout(String data);
-void saveWorkoutToMemory();
-void loadWorkoutFromMemory();
-void loadDefaultWorkout();
+void drawSeriesDotsOnCanvas(LGFX_Sprite* canvas, int completed, int total, bool animating, fixed_t animProgress);
+bool deserializeWorkout(String data, int programma, const char* nome);
+String sanitizeProgramName(const String& nome);
+void migrateLegacyWorkout();
+void ensureWebServer();
+void ensureTransitionBuffer();
+void bootMark(const char* nome);
+void reportBootProfile();
 
 // --- Classe Base per tutte le schermate ---
 class Screen {
@@ -119,9 +793,8 @@ public:
     virtual void onEnter() {}
     virtual void onExit() {}
     virtual void update() {}
-    virtual void handleInput(CST816S &touch_dev) {}
+    virtual void handleInput(const GestureEvent& gesture) {}
     virtual void draw(LGFX_Sprite* canvas) = 0;
-    virtual bool isAnimating() const { return false; }
 };
 
 // Istanza unica per ogni schermata
@@ -136,25 +809,52 @@ Screen* completionScreen;
 class MenuScreen : public Screen {
 private:
     int menuItemPressed = -1;
+    TweenId bannerTween = NO_TWEEN;
+    bool bannerErrore = false;
 public:
     void onEnter() override { menuItemPressed = -1; }
+    void onExit() override { tweens.stop(bannerTween); }
+
+    void update() override {
+        // A fine animazione serve un ultimo frame per cancellare il banner
+        if (tweens.finished(bannerTween)) needsRedraw = true;
+    }
 
-    void handleInput(CST816S &touch_dev) override {
-        if (touch_dev.data.gestureID == SWIPE_UP) {
+    void handleInput(const GestureEvent& gesture) override {
+        if (gesture.type == GESTURE_SWIPE_UP) {
             // MODIFICA: Specifica una transizione VERTICALE
             changeScreen(wifiConfigScreen, 1, VERTICAL);
             return;
         }
-        if (touch_dev.data.gestureID == SWIPE_RIGHT) {
+        if (gesture.type == GESTURE_SWIPE_RIGHT) {
             // MODIFICA: Specifica una transizione ORIZZONTALE
             changeScreen(workoutScreen, 1, HORIZONTAL);
             return;
         }
+        if (gesture.type == GESTURE_LONG_PRESS) {
+            // Pressione lunga: passa al programma successivo, saltando quelli i cui file sono spariti
+            int n = max(1, schede.numeroProgrammi());
+            int prossimo = schede.programmaAttivo();
+            for (int k = 1; k <= n; k++) {
+                prossimo = (schede.programmaAttivo() + k) % n;
+                if (schede.programmaValido(prossimo)) break;
+            }
+            bannerErrore = !schede.selezionaProgramma(prossimo);
+            if (!bannerErrore) giornoCorrente = 0;
+            tweens.stop(bannerTween);
+            bannerTween = tweens.start(PROGRAM_BANNER_DURATION, EASE_LINEAR, TWEEN_TIMER);
+            needsRedraw = true;
+            return;
+        }
+        if (gesture.type != GESTURE_TAP) return;
 
-        int touchY = touch_dev.data.y;
+        int touchY = gesture.y;
         int itemHeight = 60, startY = 20;
-        for (int i = 0; i < numeroGiorniTotali; i++) {
+        for (int i = 0; i < schede.numeroGiorni(); i++) {
             if (touchY > startY + (i * itemHeight) && touchY < startY + (i * itemHeight) + (itemHeight - 10)) {
+                // Carica il giorno dalla flash prima della transizione. Se i file non ci sono più
+                // l'archivio è già stato aggiornato e basta ridisegnare il menu.
+                if (!schede.precarica(i)) return;
                 menuItemPressed = i;
                 giornoCorrente = i;
                 // MODIFICA: Specifica una transizione ORIZZONTALE
@@ -168,7 +868,7 @@ public:
         canvas->fillScreen(COLOR_BACKGROUND);
         canvas->setTextDatum(MC_DATUM);
         int centroX = SCREEN_W / 2, itemHeight = 60, startY = 20;
-        for (int i = 0; i < numeroGiorniTotali; i++) {
+        for (int i = 0; i < schede.numeroGiorni(); i++) {
             int itemY = startY + (i * itemHeight);
             uint16_t colorGiorno = (i == menuItemPressed) ? COLOR_MENU_ITEM_PRESSED : COLOR_TEXT_PRIMARY;
             uint16_t colorMuscoli = (i == menuItemPressed) ? COLOR_MENU_ITEM_PRESSED : COLOR_TEXT_SECONDARY;
@@ -176,29 +876,36 @@ public:
             canvas->setFont(&fonts::Font4);
             canvas->setTextSize(1.5);
             canvas->setTextColor(colorGiorno);
-            canvas->drawString(miaScheda[i].nomeGiorno, centroX, itemY + 18);
+            canvas->drawString(schede.voce(i).nomeGiorno, centroX, itemY + 18);
             
             canvas->setTextSize(1);
             canvas->setFont(&fonts::Font2);
             canvas->setTextColor(colorMuscoli);
-            canvas->drawString(miaScheda[i].gruppiMuscolari, centroX, itemY + 38);
+            canvas->drawString(schede.voce(i).gruppiMuscolari, centroX, itemY + 38);
             
-            if (i < numeroGiorniTotali - 1) {
+            if (i < schede.numeroGiorni() - 1) {
                 canvas->drawLine(PADDING_HORIZONTAL, itemY + 55, SCREEN_W - PADDING_HORIZONTAL, itemY + 55, COLOR_MENU_SEPARATOR);
             }
         }
+
+        if (tweens.isActive(bannerTween)) {
+            canvas->fillRoundRect(PADDING_HORIZONTAL, SCREEN_H / 2 - 20, SCREEN_W - 2 * PADDING_HORIZONTAL, 40, 10, COLOR_BANNER_BG);
+            canvas->setFont(&fonts::Font4);
+            canvas->setTextSize(1);
+            canvas->setTextColor(COLOR_TEXT_PRIMARY);
+            canvas->drawString(bannerErrore ? "Non disponibile" : schede.nomeProgramma(schede.programmaAttivo()), centroX, SCREEN_H / 2);
+        }
     }
 };
 
 // --- Definizione della Classe WorkoutScreen ---
 class WorkoutScreen : public Screen {
 private:
-    bool animating = false;
-    unsigned long animStartTime = 0;
-    unsigned long animationDuration = ANIMATION_DURATION_SET;
+    TweenId setTween = NO_TWEEN;
+    TweenId scrollTween = NO_TWEEN;
+    const int scrollSpeed = 100; // ms per pixel
+    int scrollRange = 0;
     int scrollOffset = 0;
-    unsigned long lastScrollTime = 0;
-    const int scrollSpeed = 100;
     int esercizioCorrente = 0;
     int completedSets = 0;
 
@@ -206,78 +913,76 @@ public:
     void onEnter() override {
         esercizioCorrente = 0;
         completedSets = 0;
-        animating = false;
         needsRedraw = true;
     }
 
-    bool isAnimating() const override { return animating; }
+    void onExit() override {
+        tweens.stop(setTween);
+        tweens.stop(scrollTween);
+    }
 
-    void handleInput(CST816S &touch_dev) override {
-        if (touch_dev.data.gestureID == SWIPE_RIGHT || touch_dev.data.gestureID == SWIPE_DOWN) {
+    void handleInput(const GestureEvent& gesture) override {
+        if (gesture.type == GESTURE_SWIPE_RIGHT || gesture.type == GESTURE_SWIPE_DOWN) {
             changeScreen(menuScreen, -1, HORIZONTAL);
             return;
         }
-        if (!animating && (millis() - animStartTime > 300)) {
-            animStartTime = millis();
-            animating = true;
+        // Un tap durante l'animazione della serie viene ignorato: il tween fa già da guardia
+        if (gesture.type == GESTURE_TAP && !tweens.isActive(setTween)) {
+            setTween = tweens.start(ANIMATION_DURATION_SET, EASE_OUT_CUBIC);
         }
     }
 
     void update() override {
-        if (animating) {
-            unsigned long elapsed = millis() - animStartTime;
-            if (elapsed >= animationDuration) {
-                animating = false;
+        if (tweens.isActive(setTween)) {
+            if (tweens.finished(setTween)) {
                 completedSets++;
-                Esercizio& ex = miaScheda[giornoCorrente].esercizi[esercizioCorrente];
+                Esercizio& ex = schede.giorno(giornoCorrente).esercizi[esercizioCorrente];
                 if (completedSets >= ex.serie) {
                     completedSets = 0;
                     esercizioCorrente++;
-                    if (esercizioCorrente >= miaScheda[giornoCorrente].numeroEsercizi) {
-                        giornoCorrente = (giornoCorrente + 1) % max(1, numeroGiorniTotali);
+                    if (esercizioCorrente >= schede.giorno(giornoCorrente).numeroEsercizi) {
+                        giornoCorrente = (giornoCorrente + 1) % max(1, schede.numeroGiorni());
                         changeScreen(completionScreen, 1, HORIZONTAL); 
                     }
                 }
             }
             needsRedraw = true;
         }
+        // Il marquee ridisegna solo quando il testo si sposta di almeno un pixel
+        if (tweens.isActive(scrollTween) && currentScrollOffset() != scrollOffset) needsRedraw = true;
     }
 
+    int currentScrollOffset() const { return (scrollRange * tweens.progress(scrollTween)) >> FX_SHIFT; }
+
     void draw(LGFX_Sprite* canvas) override {
         canvas->fillScreen(COLOR_BACKGROUND);
-        Esercizio& ex = miaScheda[giornoCorrente].esercizi[esercizioCorrente];
+        Esercizio& ex = schede.giorno(giornoCorrente).esercizi[esercizioCorrente];
         int centroX = SCREEN_W / 2, centroY = SCREEN_H / 2;
         int raggio = min(SCREEN_W, SCREEN_H) / 2 - 3, spessore = 12;
 
-        float targetProgress = (float)completedSets / ex.serie;
-        if (animating) {
-            unsigned long elapsed = millis() - animStartTime;
-            float t = (float)elapsed / animationDuration;
-            if (t > 1.0f) t = 1.0f;
-            float easedT = 1 - powf(1 - t, 3);
-            float startProgress = (float)completedSets / ex.serie;
-            float endProgress = (float)(completedSets + 1) / ex.serie;
-            targetProgress = startProgress + (endProgress - startProgress) * easedT;
-        }
+        bool animating = tweens.isActive(setTween);
+        // Avanzamento dell'anello in Q12: serie completate più la frazione animata di quella in corso
+        int32_t progressFx = (int32_t)completedSets * FX_ONE;
+        if (animating) progressFx += tweens.value(setTween);
+        progressFx /= max(1, ex.serie);
         
         canvas->fillArc(centroX, centroY, raggio, raggio - spessore, 0, 360, COLOR_PROGRESS_BAR_BG);
 
-        if (targetProgress > 0.001f) {
+        if (progressFx > 0) {
             int start_angle = 270;
-            int end_angle = 270 + (int)(360 * targetProgress);
+            int end_angle = 270 + (int)((360 * progressFx) >> FX_SHIFT);
             canvas->fillArc(centroX, centroY, raggio, raggio - spessore, start_angle, end_angle, COLOR_PROGRESS_BAR_FG);
             
-            float mid_radius = raggio - spessore / 2.0f;
-            float cap_radius = spessore / 2.0f;
+            int mid_radius = raggio - spessore / 2;
+            int cap_radius = spessore / 2;
+            const int half = FX_ONE / 2; // arrotondamento al pixel più vicino
 
-            float start_angle_rad = start_angle * PI / 180.0f;
-            int start_cap_x = round(centroX + mid_radius * cos(start_angle_rad));
-            int start_cap_y = round(centroY + mid_radius * sin(start_angle_rad));
+            int start_cap_x = centroX + ((mid_radius * cosDeg(start_angle) + half) >> FX_SHIFT);
+            int start_cap_y = centroY + ((mid_radius * sinDeg(start_angle) + half) >> FX_SHIFT);
             canvas->fillCircle(start_cap_x, start_cap_y, cap_radius, COLOR_PROGRESS_BAR_FG);
 
-            float end_angle_rad = end_angle * PI / 180.0f;
-            int end_cap_x = round(centroX + mid_radius * cos(end_angle_rad));
-            int end_cap_y = round(centroY + mid_radius * sin(end_angle_rad));
+            int end_cap_x = centroX + ((mid_radius * cosDeg(end_angle) + half) >> FX_SHIFT);
+            int end_cap_y = centroY + ((mid_radius * sinDeg(end_angle) + half) >> FX_SHIFT);
             canvas->fillCircle(end_cap_x, end_cap_y, cap_radius, COLOR_PROGRESS_BAR_FG);
         }
 
@@ -285,16 +990,16 @@ public:
         canvas->setTextDatum(MC_DATUM);
         canvas->setFont(&fonts::Font4);
         String nomeEsercizio = String(ex.nome);
-        if (canvas->textWidth(nomeEsercizio) > SCREEN_W - 40) {
-            if (millis() - lastScrollTime > scrollSpeed) {
-                scrollOffset++;
-                if (scrollOffset > canvas->textWidth(nomeEsercizio) + 50) scrollOffset = 0;
-                lastScrollTime = millis();
+        scrollRange = canvas->textWidth(nomeEsercizio) + 50;
+        if (scrollRange - 50 > SCREEN_W - 40) {
+            if (!tweens.isActive(scrollTween)) {
+                scrollTween = tweens.start((unsigned long)scrollRange * scrollSpeed, EASE_LINEAR, TWEEN_LOOP);
             }
+            scrollOffset = currentScrollOffset();
             canvas->drawString(nomeEsercizio + "   " + nomeEsercizio, centroX - scrollOffset, centroY - 10);
         } else {
+            tweens.stop(scrollTween);
             canvas->drawString(nomeEsercizio, centroX, centroY - 10);
-            scrollOffset = 0;
         }
 
         canvas->setFont(&fonts::Font4);
@@ -302,7 +1007,7 @@ public:
         char bufferRep[20];
         sprintf(bufferRep, "%d reps", ex.ripetizioni);
         canvas->drawString(bufferRep, centroX, centroY + 25);
-        drawSeriesDotsOnCanvas(canvas, completedSets, ex.serie, animating, animStartTime, animationDuration);
+        drawSeriesDotsOnCanvas(canvas, completedSets, ex.serie, animating, tweens.progress(setTween));
     }
 };
 
@@ -310,6 +1015,7 @@ public:
 class WifiConfigScreen : public Screen {
 public:
     void onEnter() override {
+        ensureWebServer();
         WiFi.softAP(ssid_ap);
         dnsServer.start(53, "*", WiFi.softAPIP());
         server.begin();
@@ -320,8 +1026,8 @@ public:
         WiFi.softAPdisconnect(true);
     }
     void update() override { dnsServer.processNextRequest(); }
-    void handleInput(CST816S &touch_dev) override {
-        if (touch_dev.data.gestureID == SWIPE_DOWN) {
+    void handleInput(const GestureEvent& gesture) override {
+        if (gesture.type == GESTURE_SWIPE_DOWN) {
             changeScreen(menuScreen, -1, VERTICAL);
         }
     }
@@ -352,7 +1058,7 @@ class SleepScreen : public Screen {
 public:
     void onEnter() override { tft.setBrightness(10); }
     void onExit() override { tft.setBrightness(255); }
-    void handleInput(CST816S &touch_dev) override {
+    void handleInput(const GestureEvent& gesture) override {
         changeScreen(menuScreen, 1, VERTICAL);
     }
     void draw(LGFX_Sprite* canvas) override {
@@ -372,21 +1078,23 @@ public:
 // --- Definizione della Classe CompletionScreen con timer ---
 class CompletionScreen : public Screen {
 private:
-    unsigned long enterTime = 0;
+    TweenId displayTimer = NO_TWEEN;
     const unsigned long displayDuration = 3000; // Durata in ms (3 secondi)
 
 public:
     void onEnter() override {
-        enterTime = millis();
+        displayTimer = tweens.start(displayDuration, EASE_LINEAR, TWEEN_TIMER);
     }
 
+    void onExit() override { tweens.stop(displayTimer); }
+
     void update() override {
-        if (millis() - enterTime > displayDuration) {
+        if (tweens.finished(displayTimer)) {
             changeScreen(menuScreen, -1, HORIZONTAL);
         }
     }
 
-    void handleInput(CST816S &touch_dev) override {
+    void handleInput(const GestureEvent& gesture) override {
         // Qualsiasi tocco o swipe riporta al menu, anche prima che scada il tempo
         changeScreen(menuScreen, -1, HORIZONTAL);
     }
@@ -450,53 +1158,29 @@ public:
 
 
 // --- Funzione di Setup Principale ---
+// Avvio a stadi: prima il pannello e il menu (indice e titoli del programma attivo dall'NVS), poi il touch.
+// SPIFFS, web server e giorni completi sono caricati solo al primo uso.
 void setup() {
   Serial.begin(115200);
+  bootMark("serial");
   tft.begin();
-  touch.begin();
   pinMode(3, OUTPUT); digitalWrite(3, HIGH);
+  bootMark("panel");
 
-  bufA.createSprite(SCREEN_W, SCREEN_H);
-  bufB.createSprite(SCREEN_W, SCREEN_H);
+  // La profondità va impostata prima di createSprite, altrimenti il buffer viene allocato due volte
   bufA.setColorDepth(8);
-  bufB.setColorDepth(8);
-
-  if (!SPIFFS.begin(true)) { Serial.println("Errore SPIFFS"); return; }
-  
-  server.on("/", HTTP_GET, [](AsyncWebServerRequest *request){ 
-    if (SPIFFS.exists("/index.html")) {
-        request->send(SPIFFS, "/index.html", "text/html", false);
-    } else {
-        request->send(404, "text/plain", "File non trovato.");
-    }
-  });
-  server.on("/getWorkout", HTTP_GET, [](AsyncWebServerRequest *request){
-    String workoutString = "";
-    for (int d = 0; d < numeroGiorniTotali; d++) {
-      if (d > 0) workoutString += ";";
-      workoutString += String(miaScheda[d].nomeGiorno) + "|" + String(miaScheda[d].gruppiMuscolari) + "|";
-      for (int e = 0; e < miaScheda[d].numeroEsercizi; e++) {
-        if (e > 0) workoutString += ",";
-        workoutString += String(miaScheda[d].esercizi[e].nome) + ":" + String(miaScheda[d].esercizi[e].serie) + ":" + String(miaScheda[d].esercizi[e].ripetizioni);
-      }
-    }
-    request->send(200, "text/plain", workoutString);
-  });
-  server.on("/save", HTTP_POST, [](AsyncWebServerRequest *request){
-    if (request->hasParam("workoutData", true)) {
-      String workout = request->getParam("workoutData", true)->value();
-      deserializeWorkout(workout);
-      saveWorkoutToMemory();
-      request->send(200, "text/plain", "OK");
-    } else {
-      request->send(400, "text/plain", "Dati mancanti");
-    }
-  });
-  server.onNotFound([](AsyncWebServerRequest *request){ request->redirect("/"); });
+  bufA.createSprite(SCREEN_W, SCREEN_H);
+  bootMark("sprite");
 
+  // Vengono letti solo l'indice dei programmi e i titoli del programma attivo.
+  // Senza archivio si parte dal programma di esempio in RAM: nessuna scrittura prima del primo frame.
   preferences.begin("gymbuddy", false);
-  if (preferences.isKey("has_data")) { loadWorkoutFromMemory(); } 
-  else { loadDefaultWorkout(); saveWorkoutToMemory(); }
+  bool conversionePendente = false;
+  if (!schede.begin()) {
+    schede.caricaPredefinito();
+    conversionePendente = preferences.isKey("has_data");
+  }
+  bootMark("menu_data");
 
   menuScreen = new MenuScreen();
   workoutScreen = new WorkoutScreen();
@@ -506,11 +1190,33 @@ void setup() {
 
   currentScreen = menuScreen;
   currentScreen->onEnter();
-  ultimaAttivitaMillis = millis();
+  currentScreen->draw(&bufA);
+  bufA.pushSprite(0, 0);
+  needsRedraw = false;
+  bootMark("first_frame");
+
+  touch.begin();
+  bootMark("touch");
+
+  // La scheda delle versioni precedenti va scritta su SPIFFS: solo dopo che il menu è visibile
+  if (conversionePendente) {
+    migrateLegacyWorkout();
+    needsRedraw = true;
+    bootMark("migration");
+  }
+
+  tweens.tick();
+  ultimaAttivitaMillis = tweens.clock();
+  bootCompletato = true;
+  reportBootProfile();
 }
 
 // --- Loop Principale OTTIMIZZATO ---
 void loop() {
+    tweens.tick();
+    // I campioni vengono letti anche durante le transizioni, così nessun gesto va perso
+    pollTouch();
+
     if (isTransitioning) {
         performTransitionFrame();
         return;
@@ -519,25 +1225,31 @@ void loop() {
     if (currentScreen) {
         currentScreen->update();
 
-        if (touch.available()) {
-            if (millis() < ignoreTouchUntilMillis) return;
-            ultimaAttivitaMillis = millis();
-            currentScreen->handleInput(touch);
+        GestureEvent gesture;
+        while (!isTransitioning && gestures.poll(gesture)) {
+            // Scarta i tratti iniziati prima dell'ultimo cambio di schermata
+            if ((int16_t)(gesture.strokeId - inputEpoch) <= 0) continue;
+            touchLatency.begin(gesture.sampleUs);
+            currentScreen->handleInput(gesture);
             needsRedraw = true; 
         }
     }
 
-    if (currentScreen != sleepScreen && currentScreen != wifiConfigScreen && (millis() - ultimaAttivitaMillis > SLEEP_MODE_TIMEOUT)) {
+    if (currentScreen != sleepScreen && currentScreen != wifiConfigScreen && (tweens.clock() - ultimaAttivitaMillis > SLEEP_MODE_TIMEOUT)) {
         changeScreen(sleepScreen, 1, VERTICAL);
         return; 
     }
 
-    if (needsRedraw || (currentScreen && currentScreen->isAnimating())) {
+    if (needsRedraw || tweens.anyActive()) {
         if (currentScreen && !isTransitioning) {
             currentScreen->draw(&bufA);
             bufA.pushSprite(0, 0);
+            touchLatency.framePresented();
             needsRedraw = false;
         }
+    } else if (!gestures.isTracking()) {
+        // Nessuna animazione attiva: cede la CPU invece di girare a vuoto
+        delay(IDLE_LOOP_DELAY);
     }
 }
 
@@ -548,51 +1260,63 @@ void loop() {
 void changeScreen(Screen* newScreen, int direction, TransitionType type) {
   if (isTransitioning || !newScreen) return;
   
-  ignoreTouchUntilMillis = millis() + DEBOUNCE_DELAY;
+  inputEpoch = gestures.currentStroke();
+
+  ensureTransitionBuffer();
 
-  if(currentScreen) currentScreen->onExit();
+  // L'ultimo frame va catturato prima di onExit, che ferma i tween della schermata
+  currentScreen->draw(&bufA);
+  currentScreen->onExit();
   
   transitionToScreen = newScreen;
   transitionDirection = direction;
-  transitionProgress = 0.0f;
   currentTransitionType = type;
 
-  currentScreen->draw(&bufA);
   transitionToScreen->onEnter(); 
   transitionToScreen->draw(&bufB);
+
+  // onEnter può richiedere centinaia di ms (Wi-Fi, SPIFFS): l'orologio va riletto
+  // prima di far partire la transizione, altrimenti il primo frame arriverebbe già a fine corsa
+  tweens.tick();
+  transitionTween = tweens.start(ANIMATION_DURATION_TRANSITION, EASE_IN_OUT_SINE);
   
   isTransitioning = true;
 }
 
 void performTransitionFrame() {
-  const float speed = 0.06f;
-  transitionProgress += speed;
-  if (transitionProgress >= 1.0f) { transitionProgress = 1.0f; }
-
-  float easedProgress = 0.5f - 0.5f * cos(transitionProgress * PI);
-  
   int xA = 0, yA = 0, xB = 0, yB = 0;
 
   if (currentTransitionType == HORIZONTAL) {
-    xA = (transitionDirection > 0) ? -(SCREEN_W * easedProgress) : (SCREEN_W * easedProgress);
-    xB = (transitionDirection > 0) ? SCREEN_W - (int)(SCREEN_W * easedProgress) : -SCREEN_W + (int)(SCREEN_W * easedProgress);
+    int shift = (SCREEN_W * tweens.value(transitionTween)) >> FX_SHIFT;
+    xA = (transitionDirection > 0) ? -shift : shift;
+    xB = (transitionDirection > 0) ? SCREEN_W - shift : -SCREEN_W + shift;
   } else { // VERTICAL
-    yA = (transitionDirection > 0) ? -(SCREEN_H * easedProgress) : (SCREEN_H * easedProgress);
-    yB = (transitionDirection > 0) ? SCREEN_H - (int)(SCREEN_H * easedProgress) : -SCREEN_H + (int)(SCREEN_H * easedProgress);
+    int shift = (SCREEN_H * tweens.value(transitionTween)) >> FX_SHIFT;
+    yA = (transitionDirection > 0) ? -shift : shift;
+    yB = (transitionDirection > 0) ? SCREEN_H - shift : -SCREEN_H + shift;
   }
 
   tft.startWrite();
   bufA.pushSprite(xA, yA);
   bufB.pushSprite(xB, yB);
   tft.endWrite();
+  touchLatency.framePresented();
 
-  if (transitionProgress >= 1.0f) {
+  if (tweens.finished(transitionTween) || transitionTween == NO_TWEEN) {
     isTransitioning = false;
     currentScreen = transitionToScreen;
     needsRedraw = true;
   }
 }
 
+void pollTouch() {
+  if (touch.available()) {
+    ultimaAttivitaMillis = tweens.clock();
+    gestures.addSample(touch.data.x, touch.data.y, touch.data.event, touch.data.gestureID, tweens.clock(), micros());
+  }
+  gestures.service(tweens.clock());
+}
+
 void drawQrCode(LGFX_Sprite* canvas, int x_offset, int y_offset, QRCode* qrcode, int scale) {
     for (uint8_t y = 0; y < qrcode->size; y++) {
         for (uint8_t x = 0; x < qrcode->size; x++) {
@@ -603,7 +1327,120 @@ void drawQrCode(LGFX_Sprite* canvas, int x_offset, int y_offset, QRCode* qrcode,
     }
 }
 
-void drawSeriesDotsOnCanvas(LGFX_Sprite* canvas, int completed, int total, bool animating, unsigned long animStart, unsigned long animDur) {
+void ensureTransitionBuffer() {
+  if (bufB.getBuffer()) return;
+  bufB.setColorDepth(8);
+  bufB.createSprite(SCREEN_W, SCREEN_H);
+}
+
+// Niente formattazione automatica in lettura: su una partizione illeggibile bloccherebbe per secondi.
+// Si formatta solo quando c'è da salvare una scheda e senza filesystem non sarebbe possibile.
+bool ensureFilesystem(bool formatIfFailed) {
+  if (filesystemPronto) return true;
+  filesystemPronto = SPIFFS.begin(false) || (formatIfFailed && SPIFFS.begin(true));
+  if (!filesystemPronto) Serial.println("Errore SPIFFS");
+  else bootMark("filesystem");
+  return filesystemPronto;
+}
+
+void ensureWebServer() {
+  if (webServerPronto) return;
+  ensureFilesystem(false);
+
+  server.on("/", HTTP_GET, [](AsyncWebServerRequest *request){ 
+    if (SPIFFS.exists("/index.html")) {
+        request->send(SPIFFS, "/index.html", "text/html", false);
+    } else {
+        request->send(404, "text/plain", "File non trovato.");
+    }
+  });
+  // Formato: "<programma attivo>|<nome 0>;<nome 1>;..."
+  server.on("/programs", HTTP_GET, [](AsyncWebServerRequest *request){
+    String programsString = String(schede.programmaAttivo()) + "|";
+    for (int p = 0; p < schede.numeroProgrammi(); p++) {
+      if (p > 0) programsString += ";";
+      programsString += schede.nomeProgramma(p);
+    }
+    request->send(200, "text/plain", programsString);
+  });
+  server.on("/getWorkout", HTTP_GET, [](AsyncWebServerRequest *request){
+    int programma = schede.programmaAttivo();
+    if (request->hasParam("program")) programma = request->getParam("program")->value().toInt();
+    // Lettura diretta dalla flash: la cache dei giorni del programma attivo non viene toccata
+    GiornoAllenamento giorno;
+    String workoutString = "";
+    for (int d = 0; d < schede.numeroGiorni(programma); d++) {
+      if (!schede.leggiGiorno(programma, d, giorno)) {
+        // Mai rispondere con giorni vuoti: un nuovo salvataggio dal configuratore li cancellerebbe
+        request->send(500, "text/plain", "Errore di lettura della scheda");
+        return;
+      }
+      if (d > 0) workoutString += ";";
+      workoutString += String(giorno.nomeGiorno) + "|" + String(giorno.gruppiMuscolari) + "|";
+      for (int e = 0; e < giorno.numeroEsercizi; e++) {
+        if (e > 0) workoutString += ",";
+        workoutString += String(giorno.esercizi[e].nome) + ":" + String(giorno.esercizi[e].serie) + ":" + String(giorno.esercizi[e].ripetizioni);
+      }
+    }
+    request->send(200, "text/plain", workoutString);
+  });
+  server.on("/save", HTTP_POST, [](AsyncWebServerRequest *request){
+    if (request->hasParam("workoutData", true)) {
+      String workout = request->getParam("workoutData", true)->value();
+      int programma = schede.programmaAttivo();
+      if (request->hasParam("program", true)) programma = request->getParam("program", true)->value().toInt();
+      if (programma < 0 || programma > schede.numeroProgrammi() || programma >= MAX_PROGRAMS) {
+        request->send(400, "text/plain", "Programma non valido");
+        return;
+      }
+      String nome = "";
+      if (request->hasParam("programName", true)) nome = sanitizeProgramName(request->getParam("programName", true)->value());
+      if (nome.length() == 0) {
+        nome = (programma < schede.numeroProgrammi()) ? String(schede.nomeProgramma(programma)) : "Programma " + String(programma + 1);
+      }
+      // Il programma salvato diventa quello attivo: lo fa già salvaProgramma
+      if (!deserializeWorkout(workout, programma, nome.c_str())) {
+        request->send(500, "text/plain", "Memoria piena o errore di scrittura");
+        return;
+      }
+      giornoCorrente = 0;
+      request->send(200, "text/plain", "OK");
+    } else {
+      request->send(400, "text/plain", "Dati mancanti");
+    }
+  });
+  server.onNotFound([](AsyncWebServerRequest *request){ request->redirect("/"); });
+
+  webServerPronto = true;
+  bootMark("web_server");
+}
+
+void bootMark(const char* nome) {
+  unsigned long us = micros();
+  if (bootCompletato) {
+    // Stadi differiti: vengono riportati subito, con il tempo trascorso dall'accensione
+    Serial.printf("[boot] %-12s %8lu us (differito)\n", nome, us);
+    return;
+  }
+  if (numeroBootStages < MAX_BOOT_STAGES) {
+    bootStages[numeroBootStages++] = { nome, us };
+  }
+}
+
+void reportBootProfile() {
+  unsigned long precedente = 0;
+  for (int i = 0; i < numeroBootStages; i++) {
+    Serial.printf("[boot] %-12s %8lu us (+%lu us)\n", bootStages[i].nome, bootStages[i].us, bootStages[i].us - precedente);
+    precedente = bootStages[i].us;
+  }
+  for (int i = 0; i < numeroBootStages; i++) {
+    if (strcmp(bootStages[i].nome, "first_frame") == 0 && bootStages[i].us / 1000 > BOOT_FIRST_FRAME_BUDGET) {
+      Serial.printf("[boot] primo frame oltre il budget di %lu ms\n", BOOT_FIRST_FRAME_BUDGET);
+    }
+  }
+}
+
+void drawSeriesDotsOnCanvas(LGFX_Sprite* canvas, int completed, int total, bool animating, fixed_t animProgress) {
   int centroX = SCREEN_W / 2, y = SCREEN_H - 40, radius = 6, spacing = 25;
   int startX = centroX - ((total - 1) * spacing / 2);
   for (int i = 0; i < total; i++) {
@@ -611,116 +1448,127 @@ void drawSeriesDotsOnCanvas(LGFX_Sprite* canvas, int completed, int total, bool
     if (i < completed) {
       color = COLOR_PROGRESS_BAR_FG;
     } else if (i == completed && animating) {
-      float t = (float)(millis() - animStart) / animDur;
-      if (t > 1.0f) t = 1.0f;
-      uint16_t color_bg = COLOR_PROGRESS_BAR_BG;
-      uint16_t color_fg = COLOR_PROGRESS_BAR_FG;
-      uint8_t r_bg = (color_bg >> 11) & 0x1F;
-      uint8_t g_bg = (color_bg >> 5)  & 0x3F;
-      uint8_t b_bg = color_bg & 0x1F;
-      uint8_t r_fg = (color_fg >> 11) & 0x1F;
-      uint8_t g_fg = (color_fg >> 5)  & 0x3F;
-      uint8_t b_fg = color_fg & 0x1F;
-      uint8_t r = r_bg + (int)((r_fg - r_bg) * t);
-      uint8_t g = g_bg + (int)((g_fg - g_bg) * t);
-      uint8_t b = b_bg + (int)((b_fg - b_bg) * t);
-      color = (r << 11) | (g << 5) | b;
+      color = seriesDotRamp.at(animProgress);
     }
     canvas->fillCircle(startX + (i * spacing), y, radius, color);
   }
 }
 
-void deserializeWorkout(String data) {
-    numeroGiorniTotali = 0;
+// Analizza un giorno nel formato "nome|gruppi|esercizio:serie:ripetizioni,..."
+bool parseWorkoutDay(const String& dayData, GiornoAllenamento& giorno) {
+    memset(&giorno, 0, sizeof(giorno));
+    int pipe1 = dayData.indexOf('|');
+    int pipe2 = dayData.indexOf('|', pipe1 + 1);
+    if (pipe1 <= 0 || pipe2 <= pipe1) return false;
+
+    String nomeGiornoStr = dayData.substring(0, pipe1);
+    strncpy(giorno.nomeGiorno, nomeGiornoStr.c_str(), MAX_DAY_NAME_LEN - 1);
+
+    String gruppiMuscolariStr = dayData.substring(pipe1 + 1, pipe2);
+    strncpy(giorno.gruppiMuscolari, gruppiMuscolariStr.c_str(), MAX_MUSCLE_GROUP_LEN - 1);
+
+    String exercises = dayData.substring(pipe2 + 1);
+    int exStart = 0;
+    while (exStart < exercises.length() && giorno.numeroEsercizi < 10) {
+        int exEnd = exercises.indexOf(',', exStart);
+        if (exEnd == -1) exEnd = exercises.length();
+        String exData = exercises.substring(exStart, exEnd);
+        int colon1 = exData.indexOf(':');
+        int colon2 = exData.indexOf(':', colon1 + 1);
+        if (colon1 > 0 && colon2 > colon1) {
+            Esercizio& ex = giorno.esercizi[giorno.numeroEsercizi];
+            
+            String nomeExStr = exData.substring(0, colon1);
+            strncpy(ex.nome, nomeExStr.c_str(), MAX_EXERCISE_NAME_LEN - 1);
+
+            ex.serie = exData.substring(colon1 + 1, colon2).toInt();
+            ex.ripetizioni = exData.substring(colon2 + 1).toInt();
+            giorno.numeroEsercizi++;
+        }
+        exStart = exEnd + 1;
+    }
+    return true;
+}
+
+// Scrive in flash un giorno alla volta: in RAM c'è al massimo un giorno in costruzione.
+// Restituisce true solo se tutti i giorni e l'indice sono stati scritti.
+bool deserializeWorkout(String data, int programma, const char* nome) {
+    bool ok = true;
+    VoceMenu nuoveVoci[MAX_GIORNI];
+    GiornoAllenamento giorno;
+    int giorni = 0;
     int dayStart = 0;
-    while (dayStart < data.length() && numeroGiorniTotali < 7) {
+    while (dayStart < data.length() && giorni < MAX_GIORNI) {
         int dayEnd = data.indexOf(';', dayStart);
         if (dayEnd == -1) dayEnd = data.length();
-        String dayData = data.substring(dayStart, dayEnd);
-        int pipe1 = dayData.indexOf('|');
-        int pipe2 = dayData.indexOf('|', pipe1 + 1);
-        if (pipe1 > 0 && pipe2 > pipe1) {
-            String nomeGiornoStr = dayData.substring(0, pipe1);
-            strncpy(miaScheda[numeroGiorniTotali].nomeGiorno, nomeGiornoStr.c_str(), MAX_DAY_NAME_LEN - 1);
-            miaScheda[numeroGiorniTotali].nomeGiorno[MAX_DAY_NAME_LEN - 1] = '\0';
-
-            String gruppiMuscolariStr = dayData.substring(pipe1 + 1, pipe2);
-            strncpy(miaScheda[numeroGiorniTotali].gruppiMuscolari, gruppiMuscolariStr.c_str(), MAX_MUSCLE_GROUP_LEN - 1);
-            miaScheda[numeroGiorniTotali].gruppiMuscolari[MAX_MUSCLE_GROUP_LEN - 1] = '\0';
-
-            String exercises = dayData.substring(pipe2 + 1);
-            miaScheda[numeroGiorniTotali].numeroEsercizi = 0;
-            int exStart = 0;
-            while (exStart < exercises.length() && miaScheda[numeroGiorniTotali].numeroEsercizi < 10) {
-                int exEnd = exercises.indexOf(',', exStart);
-                if (exEnd == -1) exEnd = exercises.length();
-                String exData = exercises.substring(exStart, exEnd);
-                int colon1 = exData.indexOf(':');
-                int colon2 = exData.indexOf(':', colon1 + 1);
-                if (colon1 > 0 && colon2 > colon1) {
-                    int idx = miaScheda[numeroGiorniTotali].numeroEsercizi;
-                    
-                    String nomeExStr = exData.substring(0, colon1);
-                    strncpy(miaScheda[numeroGiorniTotali].esercizi[idx].nome, nomeExStr.c_str(), MAX_EXERCISE_NAME_LEN - 1);
-                    miaScheda[numeroGiorniTotali].esercizi[idx].nome[MAX_EXERCISE_NAME_LEN - 1] = '\0';
-
-                    miaScheda[numeroGiorniTotali].esercizi[idx].serie = exData.substring(colon1 + 1, colon2).toInt();
-                    miaScheda[numeroGiorniTotali].esercizi[idx].ripetizioni = exData.substring(colon2 + 1).toInt();
-                    miaScheda[numeroGiorniTotali].numeroEsercizi++;
-                }
-                exStart = exEnd + 1;
-            }
-            numeroGiorniTotali++;
+        if (parseWorkoutDay(data.substring(dayStart, dayEnd), giorno)) {
+            ok = ok && schede.salvaGiorno(programma, giorni, giorno);
+            memcpy(nuoveVoci[giorni].nomeGiorno, giorno.nomeGiorno, MAX_DAY_NAME_LEN);
+            memcpy(nuoveVoci[giorni].gruppiMuscolari, giorno.gruppiMuscolari, MAX_MUSCLE_GROUP_LEN);
+            giorni++;
         }
         dayStart = dayEnd + 1;
     }
+    if (ok && schede.salvaProgramma(programma, nome, nuoveVoci, giorni)) return true;
+    schede.annullaSalvataggio(programma);
+    return false;
 }
 
+// Il nome finisce nella risposta di /programs, dove '|' e ';' sono separatori
+String sanitizeProgramName(const String& nome) {
+    String pulito = "";
+    for (int i = 0; i < nome.length() && pulito.length() < MAX_PROGRAM_NAME_LEN - 1; i++) {
+        char c = nome[i];
+        if (c == '|' || c == ';' || (uint8_t)c < 0x20) continue;
+        pulito += c;
+    }
+    pulito.trim();
+    return pulito;
+}
 
-void saveWorkoutToMemory() {
-  preferences.clear();
-  preferences.putInt("num_days", numeroGiorniTotali);
-  for (int d = 0; d < numeroGiorniTotali; d++) {
+// Converte la scheda salvata campo per campo dalle versioni precedenti nel programma 0.
+// Le vecchie chiavi vengono cancellate solo dopo che il nuovo programma è stato scritto:
+// se qualcosa va storto restano dove sono e la conversione viene ritentata al prossimo avvio.
+void migrateLegacyWorkout() {
+  VoceMenu nuoveVoci[MAX_GIORNI];
+  GiornoAllenamento giorno;
+  bool ok = true;
+  int giorni = constrain(preferences.getInt("num_days", 0), 0, MAX_GIORNI);
+  for (int d = 0; d < giorni && ok; d++) {
+    memset(&giorno, 0, sizeof(giorno));
     String p = "d" + String(d);
-    preferences.putString((p + "_n").c_str(), miaScheda[d].nomeGiorno);
-    preferences.putString((p + "_gm").c_str(), miaScheda[d].gruppiMuscolari);
-    preferences.putInt((p + "_ne").c_str(), miaScheda[d].numeroEsercizi);
-    for (int e = 0; e < miaScheda[d].numeroEsercizi; e++) {
+    preferences.getString((p + "_n").c_str(), "").toCharArray(giorno.nomeGiorno, MAX_DAY_NAME_LEN);
+    preferences.getString((p + "_gm").c_str(), "").toCharArray(giorno.gruppiMuscolari, MAX_MUSCLE_GROUP_LEN);
+    giorno.numeroEsercizi = constrain(preferences.getInt((p + "_ne").c_str(), 0), 0, 10);
+    for (int e = 0; e < giorno.numeroEsercizi; e++) {
       String ep = p + "e" + String(e);
-      preferences.putString((ep + "_n").c_str(), miaScheda[d].esercizi[e].nome);
-      preferences.putInt((ep + "_s").c_str(), miaScheda[d].esercizi[e].serie);
-      preferences.putInt((ep + "_r").c_str(), miaScheda[d].esercizi[e].ripetizioni);
+      preferences.getString((ep + "_n").c_str(), "").toCharArray(giorno.esercizi[e].nome, MAX_EXERCISE_NAME_LEN);
+      giorno.esercizi[e].serie = preferences.getInt((ep + "_s").c_str(), 0);
+      giorno.esercizi[e].ripetizioni = preferences.getInt((ep + "_r").c_str(), 0);
     }
+    ok = schede.salvaGiorno(0, d, giorno);
+    memcpy(nuoveVoci[d].nomeGiorno, giorno.nomeGiorno, MAX_DAY_NAME_LEN);
+    memcpy(nuoveVoci[d].gruppiMuscolari, giorno.gruppiMuscolari, MAX_MUSCLE_GROUP_LEN);
+  }
+  if (!ok || !schede.salvaProgramma(0, "Programma 1", nuoveVoci, giorni)) {
+    schede.annullaSalvataggio(0);
+    Serial.println("Conversione della scheda non riuscita");
+    return;
   }
-  preferences.putBool("has_data", true);
-}
 
-void loadWorkoutFromMemory() {
-  numeroGiorniTotali = preferences.getInt("num_days", 0);
-  for (int d = 0; d < numeroGiorniTotali; d++) {
+  for (int d = 0; d < giorni; d++) {
     String p = "d" + String(d);
-    preferences.getString((p + "_n").c_str(), "").toCharArray(miaScheda[d].nomeGiorno, MAX_DAY_NAME_LEN);
-    preferences.getString((p + "_gm").c_str(), "").toCharArray(miaScheda[d].gruppiMuscolari, MAX_MUSCLE_GROUP_LEN);
-    miaScheda[d].numeroEsercizi = preferences.getInt((p + "_ne").c_str(), 0);
-    for (int e = 0; e < miaScheda[d].numeroEsercizi; e++) {
+    int esercizi = constrain(preferences.getInt((p + "_ne").c_str(), 0), 0, 10);
+    for (int e = 0; e < esercizi; e++) {
       String ep = p + "e" + String(e);
-      preferences.getString((ep + "_n").c_str(), "").toCharArray(miaScheda[d].esercizi[e].nome, MAX_EXERCISE_NAME_LEN);
-      miaScheda[d].esercizi[e].serie = preferences.getInt((ep + "_s").c_str(), 0);
-      miaScheda[d].esercizi[e].ripetizioni = preferences.getInt((ep + "_r").c_str(), 0);
+      preferences.remove((ep + "_n").c_str());
+      preferences.remove((ep + "_s").c_str());
+      preferences.remove((ep + "_r").c_str());
     }
+    preferences.remove((p + "_n").c_str());
+    preferences.remove((p + "_gm").c_str());
+    preferences.remove((p + "_ne").c_str());
   }
+  preferences.remove("num_days");
+  preferences.remove("has_data");
 }
-
-void loadDefaultWorkout() {
-  numeroGiorniTotali = 1;
-  strcpy(miaScheda[0].nomeGiorno, "Esempio");
-  strcpy(miaScheda[0].gruppiMuscolari, "Petto");
-  miaScheda[0].numeroEsercizi = 2;
-  strcpy(miaScheda[0].esercizi[0].nome, "Panca Piana");
-  miaScheda[0].esercizi[0].serie = 4;
-  miaScheda[0].esercizi[0].ripetizioni = 8;
-  strcpy(miaScheda[0].esercizi[1].nome, "Spinte Manubri");
-  miaScheda[0].esercizi[1].serie = 3;
-  miaScheda[0].esercizi[1].ripetizioni = 10;
-}
-